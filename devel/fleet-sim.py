@@ -0,0 +1,408 @@
+#!/usr/bin/env python3
+"""Simulates a whole room of greeters booting at once.
+
+Launches many offscreen greeter instances, each talking to a fake LightDM,
+against a local HTTP server standing in for http://greeter/. The server can
+be slowed down and made to fail. Reports per-instance time-to-interactive,
+how many instances fell back to the internal greeter, and what the server
+saw.
+
+Example, 40 greeters against a 2 MB/s server with 200 ms of latency and 5%
+of errors:
+
+    devel/fleet-sim.py --greeter build/lightdm-prologin-greeter \\
+        --instances 40 --bandwidth 2000000 --latency 200 --fail-rate 0.05
+"""
+
+import argparse
+import collections
+import functools
+import http.server
+import json
+import os
+import random
+import re
+import shutil
+import statistics
+import struct
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+# LightDM greeter protocol, see liblightdm-gobject/greeter.c.
+GREETER_MESSAGE_CONNECT = 0
+SERVER_MESSAGE_CONNECTED = 0
+
+READY_RE = re.compile(r'page ready after (\d+) ms: "?([^"]*)"?')
+FALLBACK_RE = re.compile(r"falling back to internal greeter")
+
+
+class ThemeServer(http.server.ThreadingHTTPServer):
+    daemon_threads = True
+
+    def __init__(self, args):
+        handler = functools.partial(ThemeHandler, directory=args.theme_dir)
+        super().__init__(("127.0.0.1", args.port), handler)
+        self.args = args
+        self.lock = threading.Lock()
+        self.requests = collections.Counter()
+        self.bytes_sent = 0
+        # Token bucket shared by all connections, in bytes.
+        self.tokens = 0.0
+        self.last_refill = time.monotonic()
+
+    def throttle(self, size):
+        """Blocks until 'size' bytes may be sent within the bandwidth.
+
+        The bucket holds at most one second worth of bandwidth, so 'size'
+        must not exceed the bandwidth.
+        """
+        if self.args.bandwidth <= 0:
+            return
+        while True:
+            with self.lock:
+                now = time.monotonic()
+                refill = (now - self.last_refill) * self.args.bandwidth
+                self.tokens = min(self.args.bandwidth, self.tokens + refill)
+                self.last_refill = now
+                if self.tokens >= size:
+                    self.tokens -= size
+                    return
+                missing = size - self.tokens
+            time.sleep(missing / self.args.bandwidth)
+
+    def count(self, method, path, outcome, size=0):
+        with self.lock:
+            self.requests[(method, path, outcome)] += 1
+            self.bytes_sent += size
+
+
+class ThemeHandler(http.server.SimpleHTTPRequestHandler):
+    CHUNK = 16 * 1024
+
+    def server_args(self):
+        return self.server.args
+
+    def log_message(self, *args):
+        pass
+
+    def handle_one(self, head):
+        args = self.server_args()
+        method = "HEAD" if head else "GET"
+        path = self.path.split("?")[0]
+        time.sleep(args.latency / 1000)
+        roll = random.random()
+        if roll < args.drop_rate:
+            self.server.count(method, path, "dropped")
+            self.close_connection = True
+            return
+        roll -= args.drop_rate
+        if roll < args.hang_rate:
+            self.server.count(method, path, "hung")
+            time.sleep(args.timeout)
+            self.close_connection = True
+            return
+        roll -= args.hang_rate
+        if roll < args.fail_rate:
+            self.server.count(method, path, "503")
+            self.send_error(503)
+            return
+
+        f = self.send_head()
+        if not f:
+            self.server.count(method, path, "404")
+            return
+        sent = 0
+        chunk_size = self.CHUNK
+        if args.bandwidth > 0:
+            chunk_size = min(chunk_size, args.bandwidth)
+        with f:
+            if not head:
+                while chunk := f.read(chunk_size):
+                    self.server.throttle(len(chunk))
+                    self.wfile.write(chunk)
+                    sent += len(chunk)
+        self.server.count(method, path, "200", sent)
+
+    def do_GET(self):
+        self.handle_one(head=False)
+
+    def do_HEAD(self):
+        self.handle_one(head=True)
+
+
+def read_exact(fd, size):
+    data = b""
+    while len(data) < size:
+        chunk = os.read(fd, size - len(data))
+        if not chunk:
+            return None
+        data += chunk
+    return data
+
+
+def fake_lightdm(from_greeter, to_greeter):
+    """Answers the greeter's connection request, then ignores it."""
+    try:
+        while True:
+            header = read_exact(from_greeter, 8)
+            if header is None:
+                return
+            message_id, length = struct.unpack(">II", header)
+            if read_exact(from_greeter, length) is None:
+                return
+            if message_id == GREETER_MESSAGE_CONNECT:
+                version = b"1.30.0"
+                # Version string, then an empty list of hints.
+                payload = (struct.pack(">I", len(version)) + version +
+                           struct.pack(">I", 0))
+                reply = struct.pack(">II", SERVER_MESSAGE_CONNECTED,
+                                    len(payload))
+                os.write(to_greeter, reply + payload)
+    except OSError:
+        return
+    finally:
+        os.close(from_greeter)
+        os.close(to_greeter)
+
+
+def launch_greeter(greeter, conf, workdir):
+    """Starts an offscreen greeter on 'conf', talking to a fake LightDM.
+
+    'workdir' is used as its home and runtime directory. Returns the process;
+    its log is readable as text on stderr.
+    """
+    greeter_r, daemon_w = os.pipe()
+    daemon_r, greeter_w = os.pipe()
+    env = dict(os.environ,
+               QT_QPA_PLATFORM="offscreen",
+               QTWEBENGINE_DISABLE_SANDBOX="1",
+               LIGHTDM_TO_SERVER_FD=str(greeter_w),
+               LIGHTDM_FROM_SERVER_FD=str(greeter_r),
+               XDG_RUNTIME_DIR=workdir,
+               HOME=workdir)
+    env.pop("DISPLAY", None)
+    proc = subprocess.Popen([greeter, conf], env=env,
+                            pass_fds=(greeter_r, greeter_w),
+                            stdout=subprocess.DEVNULL,
+                            stderr=subprocess.PIPE, text=True)
+    os.close(greeter_r)
+    os.close(greeter_w)
+    threading.Thread(target=fake_lightdm, args=(daemon_r, daemon_w),
+                     daemon=True).start()
+    return proc
+
+
+class Instance:
+    def __init__(self, index, args, workdir):
+        self.index = index
+        self.args = args
+        self.dir = os.path.join(workdir, f"greeter-{index}")
+        os.makedirs(self.dir, exist_ok=True)
+        self.tti_ms = None
+        self.reported_ms = None
+        self.loaded_url = None
+        self.fell_back = False
+        self.log = []
+
+    def write_conf(self):
+        conf = os.path.join(self.dir, "greeter.conf")
+        cache_dir = ""
+        if self.args.workdir_cache:
+            cache_dir = os.path.join(self.args.workdir_cache,
+                                     f"greeter-{self.index}")
+        with open(conf, "w") as f:
+            f.write("[greeter]\n")
+            f.write(f'url = "{self.args.url}"\n')
+            f.write(f"fallback_delay = {self.args.fallback_delay}\n")
+            f.write(f'cache_dir = "{cache_dir}"\n')
+        return conf
+
+    def run(self):
+        conf = self.write_conf()
+        start = time.monotonic()
+        proc = launch_greeter(self.args.greeter, conf, self.dir)
+
+        timer = threading.Timer(self.args.timeout, proc.terminate)
+        timer.start()
+        for line in proc.stderr:
+            self.log.append(line)
+            if FALLBACK_RE.search(line):
+                self.fell_back = True
+            m = READY_RE.search(line)
+            if m:
+                self.tti_ms = (time.monotonic() - start) * 1000
+                self.reported_ms = int(m.group(1))
+                self.loaded_url = m.group(2)
+                break
+        timer.cancel()
+        proc.terminate()
+        try:
+            proc.wait(5)
+        except subprocess.TimeoutExpired:
+            proc.kill()
+            proc.wait()
+        with open(os.path.join(self.dir, "greeter.log"), "w") as f:
+            f.writelines(self.log)
+
+    def result(self):
+        return {
+            "instance": self.index,
+            "tti_ms": round(self.tti_ms) if self.tti_ms is not None else None,
+            "greeter_reported_ms": self.reported_ms,
+            "loaded_url": self.loaded_url,
+            "fell_back": self.fell_back,
+        }
+
+
+def percentile(values, p):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * p))]
+
+
+def run_fleet(args, workdir):
+    """Boots all the instances at once and returns their results."""
+    instances = [Instance(i, args, workdir) for i in range(args.instances)]
+    threads = []
+    for instance in instances:
+        thread = threading.Thread(target=instance.run)
+        thread.start()
+        threads.append(thread)
+        if args.stagger:
+            time.sleep(args.stagger / 1000)
+    for thread in threads:
+        thread.join()
+    return [instance.result() for instance in instances]
+
+
+def summarize(results):
+    ttis = [r["tti_ms"] for r in results if r["tti_ms"] is not None]
+    return {
+        "interactive": len(ttis),
+        "timed_out": len(results) - len(ttis),
+        "fell_back": sum(r["fell_back"] for r in results),
+        "tti_ms_p50": percentile(ttis, 0.5) if ttis else None,
+        "tti_ms_p90": percentile(ttis, 0.9) if ttis else None,
+        "tti_ms_max": max(ttis) if ttis else None,
+        "tti_ms_mean": round(statistics.mean(ttis)) if ttis else None,
+    }
+
+
+def print_run(run):
+    print(f"{'#':>4} {'tti ms':>8} {'greeter ms':>10}  fallback  url")
+    for r in run["instances"]:
+        tti = r["tti_ms"] if r["tti_ms"] is not None else "-"
+        rep = r["greeter_reported_ms"]
+        print(f"{r['instance']:>4} {tti:>8} "
+              f"{rep if rep is not None else '-':>10}  "
+              f"{'yes' if r['fell_back'] else 'no':8}  "
+              f"{r['loaded_url'] or '-'}")
+    print()
+    for key, value in run["summary"].items():
+        print(f"{key:>12}: {value}")
+    print()
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description=__doc__,
+        formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--greeter",
+                        default=os.path.join(ROOT, "build",
+                                             "lightdm-prologin-greeter"),
+                        help="greeter binary")
+    parser.add_argument("--instances", type=int, default=20)
+    parser.add_argument("--stagger", type=int, default=0,
+                        help="ms between two instance launches")
+    parser.add_argument("--theme-dir",
+                        default=os.path.join(ROOT, "src", "fallback"),
+                        help="directory served as the theme")
+    parser.add_argument("--entry", default="login.html",
+                        help="page of the theme to load")
+    parser.add_argument("--port", type=int, default=0)
+    parser.add_argument("--bandwidth", type=int, default=0,
+                        help="server bandwidth in bytes/s, 0 for unlimited")
+    parser.add_argument("--latency", type=int, default=0,
+                        help="ms before answering each request")
+    parser.add_argument("--fail-rate", type=float, default=0,
+                        help="probability of answering 503")
+    parser.add_argument("--drop-rate", type=float, default=0,
+                        help="probability of closing without answering")
+    parser.add_argument("--hang-rate", type=float, default=0,
+                        help="probability of never answering")
+    parser.add_argument("--fallback-delay", type=int, default=2000,
+                        help="fallback_delay of the greeters, in ms")
+    parser.add_argument("--cache-dir",
+                        help="persistent cache_dir root for the greeters; "
+                             "run twice to measure warm starts. Disabled if "
+                             "unset")
+    parser.add_argument("--warm", action="store_true",
+                        help="boot the fleet twice on the same cache_dir, "
+                             "cold then warm, and report both runs")
+    parser.add_argument("--timeout", type=float, default=60,
+                        help="seconds before giving up on an instance")
+    parser.add_argument("--json", action="store_true",
+                        help="print the report as JSON")
+    parser.add_argument("--keep", action="store_true",
+                        help="keep the instance directories and logs")
+    args = parser.parse_args()
+
+    if not os.access(args.greeter, os.X_OK):
+        parser.error(f"greeter binary not found: {args.greeter}")
+    args.workdir_cache = (os.path.abspath(args.cache_dir)
+                          if args.cache_dir else None)
+
+    server = ThemeServer(args)
+    args.url = f"http://127.0.0.1:{server.server_address[1]}/{args.entry}"
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+
+    workdir = tempfile.mkdtemp(prefix="fleet-sim-")
+    if args.warm and not args.workdir_cache:
+        args.workdir_cache = os.path.join(workdir, "cache")
+    # Without --warm, the single run is reported at the top level.
+    runs = {}
+    for name in (["cold", "warm"] if args.warm else [""]):
+        runs[name] = run_fleet(args, os.path.join(workdir, name or "run"))
+    server.shutdown()
+
+    report = {}
+    for name, results in runs.items():
+        run = {"instances": results, "summary": summarize(results)}
+        if name:
+            report[name] = run
+        else:
+            report.update(run)
+    report["server"] = {
+        "requests": [
+            {"method": m, "path": p, "outcome": o, "count": c}
+            for (m, p, o), c in sorted(server.requests.items())
+        ],
+        "bytes_sent": server.bytes_sent,
+    }
+
+    if args.json:
+        json.dump(report, sys.stdout, indent=2)
+        print()
+    else:
+        for name in runs:
+            if name:
+                print(f"{name} start:")
+            print_run(report[name] if name else report)
+        print("server requests:")
+        for r in report["server"]["requests"]:
+            print(f"  {r['count']:>6} {r['method']:4} {r['outcome']:7} "
+                  f"{r['path']}")
+        print(f"  {server.bytes_sent} bytes sent")
+
+    if args.keep:
+        print(f"instance logs kept in {workdir}", file=sys.stderr)
+    else:
+        shutil.rmtree(workdir, ignore_errors=True)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,162 @@
+#!/usr/bin/env python3
+"""Checks that the greeter recovers from a renderer crash in time.
+
+Starts an offscreen greeter with a fake LightDM, waits for the page to be
+ready, kills its WebEngine renderer process with SIGKILL and checks that the
+page is ready again within the target latency, with the crash counted.
+Exits with a non-zero status on failure.
+
+    devel/renderer-crash-test.py --greeter build/lightdm-prologin-greeter
+"""
+
+import argparse
+import importlib.util
+import os
+import queue
+import re
+import shutil
+import signal
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+_spec = importlib.util.spec_from_file_location(
+    "fleet_sim", os.path.join(ROOT, "devel", "fleet-sim.py"))
+fleet_sim = importlib.util.module_from_spec(_spec)
+_spec.loader.exec_module(fleet_sim)
+
+CRASHES_RE = re.compile(r"renderer crashes: (\d+)")
+
+
+def descendants(pid):
+    """Returns the pids of all the descendants of 'pid'."""
+    children = {}
+    for entry in os.listdir("/proc"):
+        if not entry.isdigit():
+            continue
+        try:
+            with open(f"/proc/{entry}/stat") as f:
+                # The command name may contain spaces; it ends with ')'.
+                ppid = int(f.read().rsplit(")", 1)[1].split()[1])
+        except (OSError, IndexError, ValueError):
+            continue
+        children.setdefault(ppid, []).append(int(entry))
+    res, todo = [], [pid]
+    while todo:
+        for child in children.get(todo.pop(), []):
+            res.append(child)
+            todo.append(child)
+    return res
+
+
+def renderer_pids(pid):
+    res = []
+    for child in descendants(pid):
+        try:
+            with open(f"/proc/{child}/cmdline", "rb") as f:
+                cmdline = f.read().split(b"\0")
+        except OSError:
+            continue
+        if b"--type=renderer" in cmdline:
+            res.append(child)
+    return res
+
+
+def wait_ready(lines, timeout):
+    """Returns the next "page ready" line, or None after 'timeout' seconds."""
+    deadline = time.monotonic() + timeout
+    while True:
+        remaining = deadline - time.monotonic()
+        if remaining <= 0:
+            return None
+        try:
+            line = lines.get(timeout=remaining)
+        except queue.Empty:
+            return None
+        if line is None:
+            return None
+        sys.stderr.write(line)
+        if fleet_sim.READY_RE.search(line):
+            return line
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description=__doc__,
+        formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--greeter",
+                        default=os.path.join(ROOT, "build",
+                                             "lightdm-prologin-greeter"),
+                        help="greeter binary")
+    parser.add_argument("--url", default="qrc:/fallback/login.html",
+                        help="page for the greeter to load")
+    parser.add_argument("--max-recovery-ms", type=int, default=3000,
+                        help="target latency from the kill to the page "
+                             "being ready again")
+    parser.add_argument("--timeout", type=float, default=60,
+                        help="seconds to wait for the first page load")
+    args = parser.parse_args()
+
+    if not os.access(args.greeter, os.X_OK):
+        parser.error(f"greeter binary not found: {args.greeter}")
+
+    workdir = tempfile.mkdtemp(prefix="renderer-crash-test-")
+    conf = os.path.join(workdir, "greeter.conf")
+    with open(conf, "w") as f:
+        f.write(f'[greeter]\nurl = "{args.url}"\ncache_dir = ""\n')
+
+    proc = fleet_sim.launch_greeter(args.greeter, conf, workdir)
+
+    lines = queue.Queue()
+
+    def read_log():
+        for line in proc.stderr:
+            lines.put(line)
+        lines.put(None)
+
+    threading.Thread(target=read_log, daemon=True).start()
+
+    ok = False
+    try:
+        if not wait_ready(lines, args.timeout):
+            print("FAIL: page never got ready", file=sys.stderr)
+            return 1
+        renderers = renderer_pids(proc.pid)
+        if not renderers:
+            print("FAIL: no renderer process found", file=sys.stderr)
+            return 1
+
+        killed = time.monotonic()
+        for pid in renderers:
+            os.kill(pid, signal.SIGKILL)
+        line = wait_ready(lines, args.max_recovery_ms / 1000)
+        recovery_ms = round((time.monotonic() - killed) * 1000)
+        if not line:
+            print(f"FAIL: page not ready {args.max_recovery_ms} ms after "
+                  f"killing the renderer", file=sys.stderr)
+            return 1
+        m = CRASHES_RE.search(line)
+        if not m or int(m.group(1)) < 1:
+            print("FAIL: renderer crash was not counted", file=sys.stderr)
+            return 1
+        ok = True
+        print(f"OK: page ready again {recovery_ms} ms after killing the "
+              f"renderer (target {args.max_recovery_ms} ms)")
+        return 0
+    finally:
+        proc.terminate()
+        try:
+            proc.wait(5)
+        except subprocess.TimeoutExpired:
+            proc.kill()
+            proc.wait()
+        if ok:
+            shutil.rmtree(workdir, ignore_errors=True)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,99 @@
+#include "ControlServer.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <QJsonDocument>
+#include <QLocalServer>
+#include <QLocalSocket>
+
+#include "ProloGreet.h"
+
+namespace {
+
+// Commands are short; anything longer is garbage.
+constexpr int kMaxLineLength = 4096;
+
+// Only root and the user running the greeter may drive it.
+bool IsPeerAllowed(QLocalSocket* socket) {
+  struct ucred cred {};
+  socklen_t len = sizeof(cred);
+  if (getsockopt(static_cast<int>(socket->socketDescriptor()), SOL_SOCKET,
+                 SO_PEERCRED, &cred, &len) != 0) {
+    return false;
+  }
+  return cred.uid == 0 || cred.uid == getuid();
+}
+
+}  // namespace
+
+ControlServer::ControlServer(ProloGreet* prolo)
+    : QObject(prolo), prolo_(prolo), server_(new QLocalServer(this)) {
+  server_->setSocketOptions(QLocalServer::UserAccessOption);
+  connect(server_, &QLocalServer::newConnection, this,
+          &ControlServer::onNewConnection);
+}
+
+bool ControlServer::listen(const QString& path) {
+  // A previous instance may have left its socket behind.
+  QLocalServer::removeServer(path);
+  if (!server_->listen(path)) {
+    qWarning() << "cannot listen on control socket" << path << ":"
+               << server_->errorString();
+    return false;
+  }
+  qDebug() << "control socket listening on" << path;
+  return true;
+}
+
+void ControlServer::onNewConnection() {
+  while (QLocalSocket* socket = server_->nextPendingConnection()) {
+    connect(socket, &QLocalSocket::disconnected, socket,
+            &QObject::deleteLater);
+    if (!IsPeerAllowed(socket)) {
+      qWarning() << "rejecting control connection from unauthorized peer";
+      socket->disconnectFromServer();
+      continue;
+    }
+    connect(socket, &QLocalSocket::readyRead, this,
+            [this, socket]() { onReadyRead(socket); });
+  }
+}
+
+void ControlServer::onReadyRead(QLocalSocket* socket) {
+  while (socket->canReadLine()) {
+    const QString line =
+        QString::fromUtf8(socket->readLine(kMaxLineLength)).trimmed();
+    if (line.isEmpty()) continue;
+    socket->write(handleCommand(line) + "\n");
+  }
+  if (socket->bytesAvailable() > kMaxLineLength) {
+    qWarning() << "control command too long; disconnecting";
+    socket->disconnectFromServer();
+  }
+}
+
+QByteArray ControlServer::handleCommand(const QString& line) {
+  const QString command = line.section(' ', 0, 0);
+  const QString arg = line.section(' ', 1).trimmed();
+  qDebug() << "control command:" << command;
+
+  if (command == "reload" || command == "load") {
+    const QUrl url =
+        command == "load" ? QUrl(arg, QUrl::StrictMode) : QUrl();
+    // Only absolute URLs; a bare word would be taken as a relative path.
+    if (command == "load" && (!url.isValid() || url.isRelative())) {
+      return "error: invalid url";
+    }
+    return prolo_->ReloadTheme(url) ? "ok" : "deferred";
+  }
+  if (command == "message" || command == "error") {
+    if (arg.isEmpty()) return "error: missing message";
+    emit prolo_->js_->OnStatusMessage(arg, command == "error");
+    return "ok";
+  }
+  if (command == "state") {
+    return QJsonDocument(prolo_->DumpState()).toJson(QJsonDocument::Compact);
+  }
+  return "error: unknown command";
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <QObject>
+
+class ProloGreet;
+class QLocalServer;
+class QLocalSocket;
+
+// Local control interface for administration tools. Listens on a Unix socket
+// that only root and the greeter user can use, and accepts one command per
+// line:
+//   reload          reloads the theme from the configured URL
+//   load <url>      loads the theme from <url> instead
+//   message <text>  shows <text> as a status message on the page
+//   error <text>    same, as an error message
+//   state           dumps the greeter state as JSON
+// Each command gets a one-line reply: "ok", "deferred" (the reload will happen
+// once the current authentication is over), "error: <reason>" or the JSON.
+class ControlServer : public QObject {
+  Q_OBJECT
+ public:
+  explicit ControlServer(ProloGreet* prolo);
+
+  bool listen(const QString& path) __attribute__((warn_unused_result));
+
+ private slots:
+  void onNewConnection();
+  void onReadyRead(QLocalSocket* socket);
+
+ private:
+  QByteArray handleCommand(const QString& line);
+
+  ProloGreet* prolo_{};  // Not owned.
+  QLocalServer* server_;
+};
@@ -0,0 +1,10 @@
+#include "HostJitter.h"
+
+#include <QHash>
+#include <QHostInfo>
+
+int HostJitter(int max_ms) {
+  if (max_ms <= 0) return 0;
+  return static_cast<int>(qHash(QHostInfo::localHostName()) %
+                          static_cast<uint>(max_ms + 1));
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+// Returns a delay in [0, max_ms] that is stable for this host but differs
+// between hosts, so that a room booting at once doesn't hit shared services
+// (theme mirrors, the user directory) in lockstep.
+int HostJitter(int max_ms);
@@ -5,9 +5,14 @@
 #undef explicit
 
 #include <QDebug>
+#include <QProcess>
 
 namespace {
 
+// xkb supports at most 4 groups.
+constexpr int kMaxLayouts = 4;
+constexpr char kRulesNamesAtom[] = "_XKB_RULES_NAMES";
+
 // Retrieves xkb human-friendly atom name for 'cookie'.
 QString atomName(xcb_connection_t* xcb, xcb_get_atom_name_cookie_t cookie) {
   // Get atom name
@@ -192,7 +197,8 @@ void KeyboardModel::onXcbEvent() {
 }
 
 bool KeyboardModel::getKeyboardLayouts() {
-  if (!working_) return false;
+  // Also called from initialize(), before working_ is set.
+  if (!xcb_) return false;
 
   // Get atoms for short and long names
   auto cookie = xcb_xkb_get_names(
@@ -231,6 +237,93 @@ bool KeyboardModel::getKeyboardLayouts() {
   }
   free(reply);
   emit layoutsChanged();
+
+  if (pending_layout_ >= 0 && pending_layout_ < layouts_.length()) {
+    const int id = pending_layout_;
+    pending_layout_ = -1;
+    setLayout(id);
+  }
+  return true;
+}
+
+bool KeyboardModel::getRulesNames(QStringList* layouts,
+                                  QStringList* variants) {
+  auto atom_cookie =
+      xcb_intern_atom(xcb_, true, sizeof(kRulesNamesAtom) - 1, kRulesNamesAtom);
+  auto* atom_reply = xcb_intern_atom_reply(xcb_, atom_cookie, nullptr);
+  if (!atom_reply) return false;
+  const xcb_atom_t atom = atom_reply->atom;
+  free(atom_reply);
+  if (atom == XCB_ATOM_NONE) return false;
+
+  const xcb_window_t root =
+      xcb_setup_roots_iterator(xcb_get_setup(xcb_)).data->root;
+  auto cookie =
+      xcb_get_property(xcb_, false, root, atom, XCB_ATOM_STRING, 0, 1024);
+  xcb_generic_error_t* error = nullptr;
+  auto* reply = xcb_get_property_reply(xcb_, cookie, &error);
+  if (error) {
+    qWarning() << "Can't get xkb rules names:" << error->error_code;
+    return false;
+  }
+  // rules, model, layout, variant, options; NUL-separated.
+  const QList<QByteArray> names =
+      QByteArray(static_cast<const char*>(xcb_get_property_value(reply)),
+                 xcb_get_property_value_length(reply))
+          .split('\0');
+  free(reply);
+  if (names.length() < 4) return false;
+
+  layouts->clear();
+  variants->clear();
+  if (!names[2].isEmpty()) {
+    *layouts = QString::fromLatin1(names[2]).split(',');
+    *variants = QString::fromLatin1(names[3]).split(',');
+  }
+  while (variants->length() < layouts->length()) *variants << QString();
+  return true;
+}
+
+bool KeyboardModel::addLayout(const QString& layout, const QString& variant) {
+  if (!working_) return false;
+  QStringList layouts, variants;
+  if (!getRulesNames(&layouts, &variants)) {
+    qWarning() << "Can't read current layouts";
+    return false;
+  }
+  for (int i = 0; i < layouts.length(); i++) {
+    if (layouts[i] == layout && variants[i] == variant) {
+      setLayout(i);
+      return true;
+    }
+  }
+  if (layouts.length() >= kMaxLayouts) {
+    qWarning() << "Can't add layout" << layout << "; too many layouts";
+    return false;
+  }
+  layouts << layout;
+  variants << variant;
+
+  // setxkbmap keeps the rules, model and options currently set on the server.
+  // The new keyboard notification then triggers getKeyboardLayouts().
+  pending_layout_ = layouts.length() - 1;
+  auto* process = new QProcess(this);
+  connect(process, &QProcess::errorOccurred,
+          [this, process](QProcess::ProcessError error) {
+            qWarning() << "Can't run setxkbmap:" << error;
+            pending_layout_ = -1;
+            process->deleteLater();
+          });
+  connect(process, qOverload<int, QProcess::ExitStatus>(&QProcess::finished),
+          [this, process](int code, QProcess::ExitStatus status) {
+            if (status != QProcess::NormalExit || code != 0) {
+              qWarning() << "setxkbmap failed with code" << code;
+              pending_layout_ = -1;
+            }
+            process->deleteLater();
+          });
+  process->start("setxkbmap", {"-layout", layouts.join(','), "-variant",
+                               variants.join(',')});
   return true;
 }
 
@@ -40,12 +40,18 @@ class KeyboardModel : public QObject {
   void initialize();
   void disconnect();
   void setLayout(int id);
+  // Loads 'layout' with 'variant' (may be empty) as a new group after the
+  // existing ones, then switches to it. Returns false if it cannot be added.
+  bool addLayout(const QString& layout, const QString& variant);
 
  private slots:
   void onXcbEvent();
   bool getKeyboardLayouts();
 
  private:
+  // Reads the layouts and variants of the groups from the xkb rules names.
+  bool getRulesNames(QStringList* layouts, QStringList* variants);
+
   bool working_ = false;
 
   xcb_connection_t* xcb_ = nullptr;
@@ -57,5 +63,7 @@ class KeyboardModel : public QObject {
     uint8_t mask = 0;
   } numlock_, capslock_;
   int current_layout_ = 0;
+  // Group to switch to once added by addLayout(), or -1.
+  int pending_layout_ = -1;
   QList<KeyboardLayout*> layouts_;
 };
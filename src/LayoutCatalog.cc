@@ -0,0 +1,200 @@
+#include "LayoutCatalog.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QSaveFile>
+#include <QXmlStreamReader>
+#include <cstring>
+
+namespace {
+
+// Index layout: a Header, 'count' Entry records, then the NUL-terminated UTF-8
+// strings the entries point to, as offsets from the start of the file. All
+// integers are in host byte order; the index is never shared between hosts.
+constexpr char kIndexMagic[8] = {'P', 'G', 'X', 'K', 'B', 'I', 'D', 'X'};
+constexpr quint32 kIndexVersion = 1;
+
+struct Header {
+  char magic[8];
+  quint32 version;
+  quint32 count;
+  // Identifies the rules file the index was built from.
+  qint64 source_mtime;
+  qint64 source_size;
+};
+
+struct Entry {
+  quint32 layout;
+  quint32 variant;
+  quint32 description;
+};
+
+}  // namespace
+
+LayoutCatalog::LayoutCatalog(QString rules_path, QString index_path,
+                             QObject* parent)
+    : QObject(parent),
+      rules_path_(std::move(rules_path)),
+      index_path_(std::move(index_path)) {}
+
+QVector<LayoutCatalogEntry> LayoutCatalog::search(const QString& query,
+                                                  int limit) {
+  QVector<LayoutCatalogEntry> res;
+  if (!open()) return res;
+  for (int i = 0; i < count_ && res.size() < limit; i++) {
+    auto e = entry(i);
+    if (e.description.contains(query, Qt::CaseInsensitive) ||
+        e.layout.contains(query, Qt::CaseInsensitive) ||
+        e.variant.contains(query, Qt::CaseInsensitive)) {
+      res << std::move(e);
+    }
+  }
+  return res;
+}
+
+bool LayoutCatalog::contains(const QString& layout, const QString& variant) {
+  if (!open()) return false;
+  for (int i = 0; i < count_; i++) {
+    const auto e = entry(i);
+    if (e.layout == layout && e.variant == variant) return true;
+  }
+  return false;
+}
+
+bool LayoutCatalog::open() {
+  if (opened_) return data_ != nullptr;
+  opened_ = true;
+
+  if (!index_path_.isEmpty()) {
+    index_file_.setFileName(index_path_);
+    if (index_file_.open(QIODevice::ReadOnly)) {
+      const uchar* data = index_file_.map(0, index_file_.size());
+      if (data && isValid(data, index_file_.size())) {
+        data_ = data;
+        size_ = index_file_.size();
+      } else {
+        index_file_.close();
+      }
+    }
+  }
+
+  if (!data_) {
+    qDebug() << "building keyboard layout index from" << rules_path_;
+    index_buffer_ = build();
+    if (index_buffer_.isEmpty()) return false;
+    data_ = reinterpret_cast<const uchar*>(index_buffer_.constData());
+    size_ = index_buffer_.size();
+
+    if (!index_path_.isEmpty()) {
+      QSaveFile file(index_path_);
+      if (!QDir().mkpath(QFileInfo(index_path_).path()) ||
+          !file.open(QIODevice::WriteOnly) ||
+          file.write(index_buffer_) != index_buffer_.size() ||
+          !file.commit()) {
+        qWarning() << "could not save keyboard layout index" << index_path_;
+      }
+    }
+  }
+
+  count_ = static_cast<int>(reinterpret_cast<const Header*>(data_)->count);
+  return true;
+}
+
+bool LayoutCatalog::isValid(const uchar* data, qint64 size) const {
+  if (size < static_cast<qint64>(sizeof(Header))) return false;
+  const auto* header = reinterpret_cast<const Header*>(data);
+  const QFileInfo source(rules_path_);
+  return std::memcmp(header->magic, kIndexMagic, sizeof(kIndexMagic)) == 0 &&
+         header->version == kIndexVersion &&
+         header->source_mtime ==
+             source.lastModified().toMSecsSinceEpoch() &&
+         header->source_size == source.size() &&
+         size >= static_cast<qint64>(sizeof(Header) +
+                                     header->count * sizeof(Entry));
+}
+
+QByteArray LayoutCatalog::build() const {
+  QFile file(rules_path_);
+  if (!file.open(QIODevice::ReadOnly)) {
+    qWarning() << "cannot open xkb rules" << rules_path_;
+    return QByteArray();
+  }
+
+  QVector<LayoutCatalogEntry> entries;
+  QXmlStreamReader xml(&file);
+  bool in_layouts = false, in_variant = false;
+  QString layout, variant;
+  while (!xml.atEnd()) {
+    xml.readNext();
+    if (xml.isEndElement()) {
+      if (xml.name() == QLatin1String("layoutList")) in_layouts = false;
+      if (xml.name() == QLatin1String("variant")) in_variant = false;
+      continue;
+    }
+    if (!xml.isStartElement()) continue;
+    const auto name = xml.name();
+    if (name == QLatin1String("layoutList")) {
+      in_layouts = true;
+    } else if (!in_layouts) {
+      continue;
+    } else if (name == QLatin1String("variant")) {
+      in_variant = true;
+    } else if (name == QLatin1String("name")) {
+      (in_variant ? variant : layout) = xml.readElementText();
+    } else if (name == QLatin1String("description")) {
+      entries.append({layout, in_variant ? variant : QString(),
+                      xml.readElementText()});
+    }
+  }
+  if (xml.hasError()) {
+    qWarning() << "cannot parse xkb rules" << rules_path_ << ":"
+               << xml.errorString();
+    return QByteArray();
+  }
+
+  const QFileInfo source(rules_path_);
+  Header header{};
+  std::memcpy(header.magic, kIndexMagic, sizeof(kIndexMagic));
+  header.version = kIndexVersion;
+  header.count = static_cast<quint32>(entries.size());
+  header.source_mtime = source.lastModified().toMSecsSinceEpoch();
+  header.source_size = source.size();
+
+  // Strings go after the entries. Identical strings are stored once.
+  QByteArray strings;
+  QHash<QString, quint32> offsets;
+  const quint32 strings_start =
+      sizeof(Header) + static_cast<quint32>(entries.size() * sizeof(Entry));
+  auto intern = [&](const QString& s) {
+    auto it = offsets.constFind(s);
+    if (it != offsets.constEnd()) return *it;
+    const quint32 offset = strings_start + strings.size();
+    strings.append(s.toUtf8()).append('\0');
+    offsets.insert(s, offset);
+    return offset;
+  };
+
+  QByteArray index(reinterpret_cast<const char*>(&header), sizeof(header));
+  for (const auto& e : entries) {
+    const Entry record{intern(e.layout), intern(e.variant),
+                       intern(e.description)};
+    index.append(reinterpret_cast<const char*>(&record), sizeof(record));
+  }
+  index.append(strings);
+  qDebug() << "indexed" << entries.size() << "keyboard layouts in"
+           << index.size() << "bytes";
+  return index;
+}
+
+LayoutCatalogEntry LayoutCatalog::entry(int i) const {
+  const auto* e = reinterpret_cast<const Entry*>(data_ + sizeof(Header)) + i;
+  auto str = [this](quint32 offset) {
+    if (offset >= size_) return QString();
+    const auto* s = reinterpret_cast<const char*>(data_ + offset);
+    const auto max_length = static_cast<uint>(size_ - offset);
+    return QString::fromUtf8(s, static_cast<int>(qstrnlen(s, max_length)));
+  };
+  return {str(e->layout), str(e->variant), str(e->description)};
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <QByteArray>
+#include <QFile>
+#include <QObject>
+#include <QVector>
+
+struct LayoutCatalogEntry {
+  QString layout;
+  QString variant;  // Empty for the base layout.
+  QString description;
+};
+
+// Catalog of all the keyboard layouts and variants known to xkb. The xkb rules
+// XML is large and slow to parse, so it is compiled once into a compact index
+// that is memory-mapped, and rebuilt only when the XML changes.
+class LayoutCatalog : public QObject {
+  Q_OBJECT
+ public:
+  // If 'index_path' is empty, the index is built in memory at first use.
+  LayoutCatalog(QString rules_path, QString index_path,
+                QObject* parent = nullptr);
+
+  // Returns up to 'limit' entries whose names or description contain 'query',
+  // case-insensitively.
+  QVector<LayoutCatalogEntry> search(const QString& query, int limit);
+  bool contains(const QString& layout, const QString& variant);
+
+ private:
+  // Maps the index, building it first if it is missing or stale.
+  bool open();
+  bool isValid(const uchar* data, qint64 size) const;
+  QByteArray build() const;
+  LayoutCatalogEntry entry(int i) const;
+
+  const QString rules_path_;
+  const QString index_path_;
+  bool opened_ = false;
+  QFile index_file_;
+  QByteArray index_buffer_;  // When not mapped from a file.
+  const uchar* data_ = nullptr;
+  qint64 size_ = 0;
+  int count_ = 0;
+};
@@ -0,0 +1,119 @@
+#include "MirrorRace.h"
+
+#include "HostJitter.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QSaveFile>
+#include <QTimer>
+
+namespace {
+
+// Delay between the start of two consecutive probes. Gives the preferred
+// mirrors a head start without waiting for them to time out.
+constexpr int kProbeStaggerMs = 150;
+
+bool IsNetworkUrl(const QUrl& url) {
+  return url.scheme() == QLatin1String("http") ||
+         url.scheme() == QLatin1String("https");
+}
+
+}  // namespace
+
+MirrorRace::MirrorRace(QList<QUrl> mirrors, int timeout_ms, int jitter_ms,
+                       QString state_path, QObject* parent)
+    : QObject(parent),
+      mirrors_(std::move(mirrors)),
+      timeout_ms_(timeout_ms),
+      jitter_ms_(jitter_ms),
+      state_path_(std::move(state_path)),
+      network_(new QNetworkAccessManager(this)) {
+  connect(network_, &QNetworkAccessManager::finished, this,
+          &MirrorRace::onProbeFinished);
+}
+
+void MirrorRace::start() {
+  // Probe the last winner first.
+  QFile state(state_path_);
+  if (!state_path_.isEmpty() && state.open(QIODevice::ReadOnly)) {
+    last_winner_ = QUrl(QString::fromUtf8(state.readAll().trimmed()));
+    if (mirrors_.removeOne(last_winner_)) mirrors_.prepend(last_winner_);
+  }
+
+  remaining_ = mirrors_.size();
+  if (remaining_ == 0) {
+    declareWinner(QUrl());
+    return;
+  }
+
+  const int jitter = HostJitter(jitter_ms_);
+  qDebug() << "racing" << mirrors_.size() << "mirrors after" << jitter
+           << "ms of jitter";
+  for (int i = 0; i < mirrors_.size(); i++) {
+    const QUrl url = mirrors_[i];
+    QTimer::singleShot(jitter + i * kProbeStaggerMs, this,
+                       [this, url]() { probe(url); });
+  }
+}
+
+void MirrorRace::probe(const QUrl& url) {
+  if (done_) return;
+  if (!IsNetworkUrl(url)) {
+    // Local resources are always available.
+    declareWinner(url);
+    return;
+  }
+  QNetworkRequest request(url);
+  request.setTransferTimeout(timeout_ms_);
+  request.setAttribute(QNetworkRequest::RedirectPolicyAttribute,
+                       QNetworkRequest::NoLessSafeRedirectPolicy);
+  request.setAttribute(QNetworkRequest::CacheLoadControlAttribute,
+                       QNetworkRequest::AlwaysNetwork);
+  pending_ << network_->head(request);
+}
+
+void MirrorRace::onProbeFinished(QNetworkReply* reply) {
+  reply->deleteLater();
+  pending_.removeOne(reply);
+  if (done_) return;
+
+  const QUrl url = reply->request().url();
+  const int status =
+      reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+  if (reply->error() == QNetworkReply::NoError && status >= 200 &&
+      status < 300) {
+    declareWinner(url);
+    return;
+  }
+  qWarning() << "mirror" << url << "failed:" << reply->errorString();
+  if (--remaining_ == 0) declareWinner(QUrl());
+}
+
+void MirrorRace::declareWinner(const QUrl& url) {
+  done_ = true;
+  // Aborting re-enters onProbeFinished(), so detach the list first.
+  const auto pending = pending_;
+  pending_.clear();
+  for (auto* reply : pending) reply->abort();
+
+  if (url.isEmpty()) {
+    qWarning() << "no mirror answered";
+  } else {
+    qDebug() << "mirror" << url << "won the race";
+    if (url != last_winner_ && !state_path_.isEmpty()) rememberWinner(url);
+  }
+  emit finished(url);
+}
+
+void MirrorRace::rememberWinner(const QUrl& url) {
+  QSaveFile state(state_path_);
+  if (!QDir().mkpath(QFileInfo(state_path_).path()) ||
+      !state.open(QIODevice::WriteOnly) ||
+      state.write(url.toString().toUtf8()) < 0 || !state.commit()) {
+    qWarning() << "could not remember mirror in" << state_path_;
+  }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <QList>
+#include <QObject>
+#include <QUrl>
+
+class QNetworkAccessManager;
+class QNetworkReply;
+
+// Probes theme mirrors concurrently and reports the first one that answers
+// successfully. The last winner is remembered in 'state_path' and probed first
+// at next start. Probes go through the application proxy, if any.
+class MirrorRace : public QObject {
+  Q_OBJECT
+ public:
+  MirrorRace(QList<QUrl> mirrors, int timeout_ms, int jitter_ms,
+             QString state_path, QObject* parent = nullptr);
+
+  void start();
+
+ signals:
+  // Emitted once. 'winner' is empty if no mirror answered.
+  void finished(const QUrl& winner);
+
+ private slots:
+  void probe(const QUrl& url);
+  void onProbeFinished(QNetworkReply* reply);
+
+ private:
+  void declareWinner(const QUrl& url);
+  void rememberWinner(const QUrl& url);
+
+  QList<QUrl> mirrors_;
+  const int timeout_ms_;
+  const int jitter_ms_;
+  const QString state_path_;
+  QUrl last_winner_;
+  QNetworkAccessManager* network_;
+  QList<QNetworkReply*> pending_;
+  int remaining_ = 0;
+  bool done_ = false;
+};
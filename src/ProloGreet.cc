@@ -1,21 +1,121 @@
 #include "ProloGreet.h"
 
+#include "ControlServer.h"
+#include "MirrorRace.h"
+
 #include <QApplication>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
 #include <QGuiApplication>
+#include <QImageReader>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonParseError>
 #include <QLightDM/Power>
 #include <QLightDM/SessionsModel>
+#include <QSaveFile>
 #include <QScreen>
 #include <QStackedLayout>
 #include <QTimer>
 #include <QWebChannel>
+#include <QWebEngineCookieStore>
+#include <QWebEngineProfile>
 #include <QWebEngineSettings>
 #include <QWebEngineView>
+#include <poll.h>
+
+#include <csignal>
+#include <limits>
 
 namespace {
 
+// Time to wait after the page loads before snapshotting it, so that late
+// layout & web fonts have settled.
+constexpr int kSplashCaptureDelayMs = 1500;
+// Maximum number of splash snapshots kept on disk (different URLs, screens),
+// least recently used evicted first.
+constexpr int kMaxSplashFiles = 4;
+// Source of the keyboard layout catalog.
+constexpr char kXkbRulesPath[] = "/usr/share/X11/xkb/rules/evdev.xml";
+// Returns true if any text-like input of the page holds a value.
+constexpr char kHasUserInputJs[] = R"(
+  Array.from(document.querySelectorAll(
+      'input:not([type]), input[type=text], input[type=password], textarea'))
+    .some(e => e.value.length > 0)
+)";
+
+// How often the renderer is pinged, and how long it may take to answer
+// before being considered hung.
+constexpr int kRendererPingIntervalMs = 2000;
+constexpr int kRendererHangTimeoutMs = 6000;
+// After that many renderer failures in a row, give up on the requested page
+// and use the internal greeter. Failures further apart than the window are not
+// considered in a row.
+constexpr int kMaxRendererFailures = 3;
+constexpr int kRendererFailureWindowMs = 60000;
+// Backoff between attempts to connect to LightDM.
+constexpr int kLightDMInitialRetryDelayMs = 250;
+constexpr int kLightDMMaxRetryDelayMs = 8000;
+
+// Name of the persistent web profile, and the entries of its storage that may
+// hold data from a previous page visit (cookies, web storage), wiped at start.
+constexpr char kProfileName[] = "greeter";
+constexpr const char* kProfileUserData[] = {
+    "Cookies",      "Cookies-journal",     "Local Storage", "Session Storage",
+    "IndexedDB",    "databases",           "File System",   "Service Worker",
+    "QuotaManager", "QuotaManager-journal"};
+
+// Returns a profile that keeps the HTTP and compiled code caches across starts
+// in the cache directory, but nothing about the user. Off-the-record if
+// caching is disabled.
+QWebEngineProfile* CreateWebProfile(const Options& options, QObject* parent) {
+  if (options.cache_dir.isEmpty()) return new QWebEngineProfile(parent);
+
+  const QDir dir(options.cache_dir);
+  const QString storage = dir.filePath("profile");
+  for (const char* entry : kProfileUserData) {
+    const QString path = QDir(storage).filePath(entry);
+    if (QFileInfo(path).isDir()) {
+      QDir(path).removeRecursively();
+    } else {
+      QFile::remove(path);
+    }
+  }
+
+  auto* profile = new QWebEngineProfile(kProfileName, parent);
+  profile->setPersistentStoragePath(storage);
+  // Both paths persist, so does the V8 code cache that Chromium keeps there.
+  profile->setCachePath(dir.filePath("http"));
+  profile->setHttpCacheType(QWebEngineProfile::DiskHttpCache);
+  // In bytes, which must fit an int.
+  profile->setHttpCacheMaximumSize(static_cast<int>(qBound<qint64>(
+      1, qint64(options.web_cache_size) * 1024 * 1024,
+      std::numeric_limits<int>::max())));
+  profile->setPersistentCookiesPolicy(QWebEngineProfile::NoPersistentCookies);
+  profile->cookieStore()->deleteAllCookies();
+  return profile;
+}
+
+// Returns true if the pipes inherited from the LightDM daemon are missing or
+// closed. Connecting can then never succeed in this process.
+bool IsLightDMChannelGone() {
+  bool to_ok = false, from_ok = false;
+  const int to_fd =
+      qEnvironmentVariableIntValue("LIGHTDM_TO_SERVER_FD", &to_ok);
+  const int from_fd =
+      qEnvironmentVariableIntValue("LIGHTDM_FROM_SERVER_FD", &from_ok);
+  if (!to_ok || !from_ok) return true;
+  pollfd fds[] = {{to_fd, POLLOUT, 0}, {from_fd, POLLIN, 0}};
+  if (poll(fds, 2, 0) < 0) return false;  // Can't tell; assume it may clear.
+  // The daemon closed its read end, or the fd is not open.
+  if (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL)) return true;
+  if (fds[1].revents & POLLNVAL) return true;
+  // The daemon closed its write end and there is nothing left to read.
+  return (fds[1].revents & POLLHUP) && !(fds[1].revents & POLLIN);
+}
+
 void SetWebviewOptions(QWebEngineView* view) {
   view->setContextMenuPolicy(Qt::NoContextMenu);
   using S = QWebEngineSettings;
@@ -27,6 +127,40 @@ void SetWebviewOptions(QWebEngineView* view) {
   settings->setAttribute(S::LocalContentCanAccessRemoteUrls, false);
 }
 
+// PNG text key holding a hash of the snapshot pixels, so that an unchanged
+// snapshot can be detected without decoding the cached one.
+constexpr char kSplashHashKey[] = "PixelsHash";
+
+QString SplashHash(const QImage& image) {
+  const auto bits = QByteArray::fromRawData(
+      reinterpret_cast<const char*>(image.constBits()),
+      static_cast<int>(image.sizeInBytes()));
+  return QCryptographicHash::hash(bits, QCryptographicHash::Sha1).toHex();
+}
+
+// Atomically writes the splash 'image' to 'path' and evicts old snapshots.
+void SaveSplash(QImage image, const QString& path) {
+  QDir dir = QFileInfo(path).dir();
+  if (!dir.mkpath(".")) {
+    qWarning() << "could not create splash cache directory" << dir.path();
+    return;
+  }
+  image.setText(kSplashHashKey, SplashHash(image));
+  QSaveFile file(path);
+  // Low compression: decoding speed at next start matters more than size.
+  if (!file.open(QIODevice::WriteOnly) || !image.save(&file, "PNG", 80) ||
+      !file.commit()) {
+    qWarning() << "could not save splash to" << path;
+    return;
+  }
+  qDebug() << "saved splash snapshot to" << path;
+
+  const auto files = dir.entryInfoList({"*.png"}, QDir::Files, QDir::Time);
+  for (int i = kMaxSplashFiles; i < files.size(); i++) {
+    QFile::remove(files[i].filePath());
+  }
+}
+
 QColor InverseColor(const QColor& color) {
   qreal r, g, b;
   color.getRgbF(&r, &g, &b, nullptr);
@@ -37,6 +171,7 @@ QColor InverseColor(const QColor& color) {
 
 ProloGreet::ProloGreet(Options options, QWidget* parent)
     : state_(), options_(std::move(options)), QWidget(parent) {
+  startup_time_.start();
   {
     auto pal = palette();
     pal.setColor(QPalette::Window, options.background_color);
@@ -46,6 +181,9 @@ ProloGreet::ProloGreet(Options options, QWidget* parent)
   }
 
   webview_ = new QWebEngineView(this);
+  // Created after webview_, so that it is destroyed after the page.
+  profile_ = CreateWebProfile(options_, this);
+  webview_->setPage(new QWebEnginePage(profile_, webview_));
   SetWebviewOptions(webview_);
   {
     auto pal = webview_->palette();
@@ -54,8 +192,22 @@ ProloGreet::ProloGreet(Options options, QWidget* parent)
     webview_->setPalette(pal);
     webview_->page()->setBackgroundColor(options.background_color);
   }
+  connect(webview_, &QWebEngineView::loadStarted, this,
+          &ProloGreet::OnWebviewLoadStart);
   connect(webview_, &QWebEngineView::loadFinished, this,
           &ProloGreet::OnWebviewLoadFinish);
+  connect(webview_->page(), &QWebEnginePage::renderProcessTerminated, this,
+          &ProloGreet::OnRenderProcessTerminated);
+
+  fallback_timer_ = new QTimer(this);
+  fallback_timer_->setSingleShot(true);
+  connect(fallback_timer_, &QTimer::timeout, this,
+          &ProloGreet::MaybeFallbackToInternalGreeter);
+
+  renderer_watchdog_ = new QTimer(this);
+  renderer_watchdog_->setInterval(kRendererPingIntervalMs);
+  connect(renderer_watchdog_, &QTimer::timeout, this,
+          &ProloGreet::PingRenderer);
 
   status_info_ = new QLabel("Prologin greeter is starting up…", this);
   status_info_->setAlignment(Qt::AlignCenter);
@@ -68,6 +220,7 @@ ProloGreet::ProloGreet(Options options, QWidget* parent)
   setLayout(layout_);
   QRect screenRect = QGuiApplication::primaryScreen()->geometry();
   setGeometry(screenRect);
+  ShowCachedSplash();
 
   js_ = new GreetJS(this);
 
@@ -77,21 +230,11 @@ ProloGreet::ProloGreet(Options options, QWidget* parent)
   webview_->page()->setWebChannel(channel_);
 
   // LightDM APIs.
-  lightdm_ = new QLightDM::Greeter(this);
-  // We want to die, not be reset. It's easier to not screw up state that way.
-  lightdm_->setResettable(false);
+  CreateLightDMGreeter();
   lightdm_power_ = new QLightDM::PowerInterface(this);
   lightdm_sessions_ = new QLightDM::SessionsModel(
       QLightDM::SessionsModel::SessionType::LocalSessions, this);
 
-  connect(lightdm_, &QLightDM::Greeter::idle, this, &QApplication::quit);
-  connect(lightdm_, &QLightDM::Greeter::showMessage, this,
-          &ProloGreet::OnLightDMMessage);
-  connect(lightdm_, &QLightDM::Greeter::showPrompt, this,
-          &ProloGreet::OnLightDMPrompt);
-  connect(lightdm_, &QLightDM::Greeter::authenticationComplete, this,
-          &ProloGreet::OnLightDMAuthenticationComplete);
-
   keyboard_ = new KeyboardModel(this);
   connect(keyboard_, &KeyboardModel::currentLayoutChanged,
           [this](int id) { js_->OnKeyboardLayoutChange(id); });
@@ -102,28 +245,172 @@ ProloGreet::ProloGreet(Options options, QWidget* parent)
   connect(keyboard_, &KeyboardModel::numLockStateChanged,
           [this](bool enabled) { js_->OnNumLockChange(enabled); });
   keyboard_->initialize();
+  layout_catalog_ = new LayoutCatalog(
+      kXkbRulesPath,
+      options_.cache_dir.isEmpty()
+          ? QString()
+          : QDir(options_.cache_dir).filePath("xkb-layouts.idx"),
+      this);
+
+  if (options_.user_search) {
+    const QString snapshot_path =
+        options_.cache_dir.isEmpty()
+            ? QString()
+            : QDir(options_.cache_dir).filePath("users");
+    users_ = new UserDirectory(snapshot_path, this);
+    connect(users_, &UserDirectory::resultsReady,
+            [this](int id, const QVector<UserEntry>& users, bool more) {
+              QVariantList list;
+              for (const auto& user : users) {
+                QVariantMap map;
+                map.insert("login", user.login);
+                map.insert("name", user.name);
+                list.append(map);
+              }
+              js_->OnUserSearchResults(id, QVariant::fromValue(list), more);
+            });
+  }
+
+  if (!options_.control_socket.isEmpty()) {
+    control_ = new ControlServer(this);
+    if (!control_->listen(options_.control_socket)) {
+      delete control_;
+      control_ = nullptr;
+    }
+  }
 }
 
-bool ProloGreet::Start() {
+void ProloGreet::Start() {
+  // Load the requested URL. Fallback to internal log-in screen after some time.
+  // This does not need LightDM, so don't wait for it.
+  LoadTheme();
+
   // Connect to LightDM.
+  lightdm_connect_time_.start();
+  ConnectToLightDM();
+}
+
+void ProloGreet::CreateLightDMGreeter() {
+  lightdm_ = new QLightDM::Greeter(this);
+  // We want to die, not be reset. It's easier to not screw up state that way.
+  lightdm_->setResettable(false);
+
+  connect(lightdm_, &QLightDM::Greeter::idle, this, &QApplication::quit);
+  connect(lightdm_, &QLightDM::Greeter::showMessage, this,
+          &ProloGreet::OnLightDMMessage);
+  connect(lightdm_, &QLightDM::Greeter::showPrompt, this,
+          &ProloGreet::OnLightDMPrompt);
+  connect(lightdm_, &QLightDM::Greeter::authenticationComplete, this,
+          &ProloGreet::OnLightDMAuthenticationComplete);
+}
+
+void ProloGreet::ConnectToLightDM() {
   status_info_->setText("Connecting to LightDM…");
-  if (!lightdm_->connectSync()) {
+  if (lightdm_->connectSync()) {
+    qDebug() << "connected to LightDM after" << lightdm_connect_time_.elapsed()
+             << "ms";
+    lightdm_connected_ = true;
+    emit js_->OnLightDMConnectionChange(true);
+    return;
+  }
+
+  const qint64 remaining =
+      options_.lightdm_connect_deadline - lightdm_connect_time_.elapsed();
+  const bool gone = IsLightDMChannelGone();
+  if (gone || remaining <= 0) {
+    if (gone) {
+      qCritical() << "LightDM channel is closed; giving up";
+    } else {
+      qCritical() << "could not connect to LightDM in"
+                  << options_.lightdm_connect_deadline << "ms; giving up";
+    }
     status_info_->setText("Could not connect to LightDM.");
-    return false;
+    // Let LightDM respawn us; exit() is a no-op outside the event loop.
+    QTimer::singleShot(0, []() { QApplication::exit(42); });
+    return;
   }
 
-  // Load the requested URL. Fallback to internal log-in screen after some time.
-  webview_uses_fallback_ = false;
-  webview_->load(options_.url);
-  QTimer::singleShot(options_.fallback_delay,
-                     [this]() { MaybeFallbackToInternalGreeter(); });
-  return true;
+  if (lightdm_retry_delay_ == 0) {
+    lightdm_retry_delay_ = kLightDMInitialRetryDelayMs;
+    emit js_->OnLightDMConnectionChange(false);
+  }
+  const int delay =
+      static_cast<int>(qMin<qint64>(lightdm_retry_delay_, remaining));
+  qWarning() << "could not connect to LightDM; retrying in" << delay << "ms";
+  lightdm_retry_delay_ =
+      qMin(lightdm_retry_delay_ * 2, kLightDMMaxRetryDelayMs);
+  QTimer::singleShot(delay, this, &ProloGreet::ConnectToLightDM);
+}
+
+void ProloGreet::LoadTheme() {
+  // A race still in flight is for the previous request; its winner must not
+  // override this one.
+  if (mirror_race_) {
+    mirror_race_->disconnect(this);
+    mirror_race_->deleteLater();
+    mirror_race_ = nullptr;
+  }
+  if (options_.mirrors.size() <= 1) {
+    theme_url_ = QUrl(options_.url);
+    LoadUrl(theme_url_);
+    return;
+  }
+  QList<QUrl> mirrors;
+  for (const auto& mirror : options_.mirrors) mirrors << QUrl(mirror);
+  const QString state_path =
+      options_.cache_dir.isEmpty()
+          ? QString()
+          : QDir(options_.cache_dir).filePath("mirror");
+  mirror_race_ = new MirrorRace(mirrors, options_.mirror_timeout,
+                                options_.mirror_jitter, state_path, this);
+  connect(mirror_race_, &MirrorRace::finished, this,
+          &ProloGreet::OnMirrorRaceFinished);
+  connect(mirror_race_, &MirrorRace::finished, mirror_race_,
+          &QObject::deleteLater);
+  mirror_race_->start();
+}
+
+void ProloGreet::LoadUrl(const QUrl& url) {
+  webview_url_ = url;
+  webview_load_success_ = false;
+  webview_uses_fallback_ = url == QUrl(kFallbackUrl);
+  renderer_watchdog_->stop();
+  // A reload bypassing the cache always applies to the last committed page,
+  // never to a pending navigation. Another URL is loaded first, then reloaded
+  // once committed, see OnWebviewLoadFinish().
+  const bool bypass = bypass_cache_ && !webview_uses_fallback_;
+  bypass_cache_ = false;
+  bypass_cache_after_load_ = false;
+  if (bypass && url == webview_->url()) {
+    webview_->triggerPageAction(QWebEnginePage::ReloadAndBypassCache);
+  } else {
+    bypass_cache_after_load_ = bypass;
+    webview_->load(url);
+  }
+  if (!webview_uses_fallback_) fallback_timer_->start(options_.fallback_delay);
+}
+
+void ProloGreet::CancelAuthentication() {
+  if (state_.state != AuthState::IDLE) {
+    qDebug() << "cancelling in-flight authentication";
+    lightdm_->cancelAuthentication();
+  }
+  state_.username.clear();
+  state_.password.clear();
+  state_.session.clear();
+  state_.got_business_logic_error = false;
+  state_.state = AuthState::IDLE;
 }
 
 void ProloGreet::StartLightDmAuthentication(const QString& username,
                                             const QString& password,
                                             const QString& session) {
   qDebug() << "starting LightDM authentication flow";
+  if (!lightdm_connected_) {
+    qWarning() << "not connected to LightDM in" << __FUNCTION__;
+    emit js_->OnLoginError("waiting for the login manager");
+    return;
+  }
   if (state_.state != AuthState::IDLE) {
     qWarning() << "illegal state in" << __FUNCTION__ << (int)state_.state;
     return;
@@ -202,6 +489,7 @@ void ProloGreet::OnLightDMAuthenticationComplete() {
       qDebug() << "sending 'incorrect password' since we don't know better";
       emit js_->OnLoginError("incorrect password");
     }
+    MaybeRunDeferredReload();
     return;
   }
 
@@ -227,13 +515,37 @@ void ProloGreet::OnLightDMAuthenticationComplete() {
   close();
 }
 
+void ProloGreet::OnWebviewLoadStart() {
+  // Navigations may drop pending JavaScript callbacks, including the ones the
+  // page starts by itself; don't take that for a hang.
+  renderer_watchdog_->stop();
+  renderer_ping_pending_ = false;
+}
+
 void ProloGreet::OnWebviewLoadFinish(bool ok) {
+  renderer_ping_pending_ = false;
+  renderer_watchdog_->start();
+  if (ok && bypass_cache_after_load_) {
+    // The page may come from the cache; get it fresh before revealing it.
+    bypass_cache_after_load_ = false;
+    webview_->triggerPageAction(QWebEnginePage::ReloadAndBypassCache);
+    return;
+  }
   webview_load_success_ = ok;
   if (!ok) {
     MaybeFallbackToInternalGreeter();
   } else {
     // Finally reveal the webview. Prevents flashes of default background color.
     layout_->setCurrentWidget(webview_);
+    HideSplash();
+    // Parsed by devel/fleet-sim.py and devel/renderer-crash-test.py.
+    qInfo() << "page ready after" << startup_time_.elapsed() << "ms:"
+            << webview_url_.toString() << "renderer crashes:"
+            << renderer_crash_count_ << "hangs:" << renderer_hang_count_;
+    if (!webview_uses_fallback_) {
+      QTimer::singleShot(kSplashCaptureDelayMs, this,
+                         &ProloGreet::CaptureSplash);
+    }
   }
 }
 
@@ -241,11 +553,201 @@ void ProloGreet::MaybeFallbackToInternalGreeter() {
   if (webview_load_success_) return;
   if (webview_uses_fallback_) {
     qWarning() << "could not load fallback internal greeter";
+    HideSplash();
     return;
   }
   qWarning()
       << "could not load requested url; falling back to internal greeter";
-  webview_->load(QUrl(kFallbackUrl));
+  LoadUrl(QUrl(kFallbackUrl));
+}
+
+void ProloGreet::OnMirrorRaceFinished(const QUrl& winner) {
+  if (winner.isEmpty()) {
+    MaybeFallbackToInternalGreeter();
+  } else {
+    theme_url_ = winner;
+    LoadUrl(winner);
+  }
+}
+
+void ProloGreet::OnRenderProcessTerminated(
+    QWebEnginePage::RenderProcessTerminationStatus status, int exit_code) {
+  if (renderer_hung_) {
+    renderer_hung_ = false;
+  } else {
+    renderer_crash_count_++;
+    qWarning() << "renderer process terminated, status" << status << "code"
+               << exit_code << "; crash count" << renderer_crash_count_;
+  }
+  RecoverFromRendererFailure();
+}
+
+void ProloGreet::PingRenderer() {
+  if (renderer_ping_pending_) {
+    if (renderer_ping_sent_.elapsed() < kRendererHangTimeoutMs) return;
+    renderer_watchdog_->stop();
+    renderer_hang_count_++;
+    qWarning() << "renderer unresponsive for" << renderer_ping_sent_.elapsed()
+               << "ms; hang count" << renderer_hang_count_;
+    // Killing the renderer ends up in OnRenderProcessTerminated().
+    const qint64 pid = webview_->page()->renderProcessPid();
+    if (pid > 0 && ::kill(static_cast<pid_t>(pid), SIGKILL) == 0) {
+      renderer_hung_ = true;
+    } else {
+      RecoverFromRendererFailure();
+    }
+    return;
+  }
+  const int id = ++renderer_ping_id_;
+  renderer_ping_pending_ = true;
+  renderer_ping_sent_.start();
+  webview_->page()->runJavaScript("0", [this, id](const QVariant&) {
+    if (id == renderer_ping_id_) renderer_ping_pending_ = false;
+  });
+}
+
+void ProloGreet::RecoverFromRendererFailure() {
+  renderer_watchdog_->stop();
+  renderer_ping_pending_ = false;
+  // Whatever the page was doing is lost, including the form the user
+  // submitted; don't leave LightDM waiting on it.
+  CancelAuthentication();
+  layout_->setCurrentWidget(status_info_);
+  status_info_->setText("Restarting the greeter page…");
+
+  if (!renderer_last_failure_.isValid() ||
+      renderer_last_failure_.elapsed() > kRendererFailureWindowMs) {
+    renderer_recent_failures_ = 0;
+  }
+  renderer_last_failure_.start();
+  renderer_recent_failures_++;
+
+  // A reload was waiting for the authentication we just cancelled.
+  QUrl url = webview_url_;
+  if (reload_deferred_) {
+    reload_deferred_ = false;
+    if (!deferred_reload_url_.isEmpty()) {
+      options_.url = deferred_reload_url_.toString();
+      options_.mirrors = QStringList{options_.url};
+      theme_url_ = deferred_reload_url_;
+    }
+    if (!theme_url_.isEmpty()) url = theme_url_;
+    bypass_cache_ = true;
+  }
+
+  if (renderer_recent_failures_ >= kMaxRendererFailures &&
+      !webview_uses_fallback_) {
+    qWarning() << "renderer failed" << renderer_recent_failures_
+               << "times in a row; falling back to internal greeter";
+    LoadUrl(QUrl(kFallbackUrl));
+  } else {
+    qWarning() << "reloading" << url << "after renderer failure";
+    LoadUrl(url);
+  }
+}
+
+bool ProloGreet::ReloadTheme(const QUrl& url) {
+  if (state_.state != AuthState::IDLE) {
+    qDebug() << "deferring theme reload until authentication is over";
+    reload_deferred_ = true;
+    deferred_reload_url_ = url;
+    return false;
+  }
+  // An explicit URL replaces the configured mirrors. Otherwise race them
+  // again: the previous winner may have gone away since.
+  if (!url.isEmpty()) {
+    options_.url = url.toString();
+    options_.mirrors = QStringList{options_.url};
+  }
+  qDebug() << "reloading theme from" << options_.mirrors;
+  // Failures of the previous theme don't count against this one.
+  renderer_recent_failures_ = 0;
+  // The theme was most likely updated; don't serve it from the cache.
+  bypass_cache_ = true;
+  LoadTheme();
+  return true;
+}
+
+void ProloGreet::MaybeRunDeferredReload() {
+  if (!reload_deferred_) return;
+  reload_deferred_ = false;
+  ReloadTheme(deferred_reload_url_);
+}
+
+QJsonObject ProloGreet::DumpState() const {
+  QJsonObject state;
+  state.insert("url", options_.url);
+  state.insert("themeUrl", theme_url_.toString());
+  state.insert("loadedUrl", webview_url_.toString());
+  state.insert("loaded", webview_load_success_);
+  state.insert("usesFallback", webview_uses_fallback_);
+  state.insert("authState", static_cast<int>(state_.state));
+  state.insert("lightdmConnected", lightdm_connected_);
+  state.insert("reloadDeferred", reload_deferred_);
+  state.insert("rendererCrashes", renderer_crash_count_);
+  state.insert("rendererHangs", renderer_hang_count_);
+  return state;
+}
+
+QString ProloGreet::SplashPath() const {
+  if (options_.cache_dir.isEmpty()) return QString();
+  const QScreen* screen = QGuiApplication::primaryScreen();
+  const QString key = QStringLiteral("%1@%2x%3*%4")
+                          .arg(options_.url)
+                          .arg(screen->geometry().width())
+                          .arg(screen->geometry().height())
+                          .arg(screen->devicePixelRatio());
+  const auto hash =
+      QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha1);
+  return QDir(options_.cache_dir)
+      .filePath(QStringLiteral("splash/%1.png").arg(QString(hash.toHex())));
+}
+
+void ProloGreet::ShowCachedSplash() {
+  const QString path = SplashPath();
+  if (path.isEmpty()) return;
+  QPixmap pixmap(path);
+  if (pixmap.isNull()) return;
+  qDebug() << "showing cached splash" << path;
+  // The snapshot was grabbed in device pixels.
+  pixmap.setDevicePixelRatio(devicePixelRatioF());
+  splash_ = new QLabel(this);
+  splash_->setAlignment(Qt::AlignCenter);
+  splash_->setPixmap(pixmap);
+  layout_->addWidget(splash_);
+  layout_->setCurrentWidget(splash_);
+}
+
+void ProloGreet::HideSplash() {
+  if (!splash_) return;
+  layout_->removeWidget(splash_);
+  splash_->deleteLater();
+  splash_ = nullptr;
+}
+
+void ProloGreet::CaptureSplash() {
+  const QString path = SplashPath();
+  if (path.isEmpty()) return;
+  // Never snapshot anything the user may have typed.
+  if (state_.state != AuthState::IDLE || webview_uses_fallback_) return;
+  webview_->page()->runJavaScript(
+      kHasUserInputJs, [this, path](const QVariant& dirty) {
+        if (dirty.toBool() || state_.state != AuthState::IDLE) return;
+        const QImage image = webview_->grab().toImage();
+        if (image.isNull()) return;
+        // Avoid needless disk writes. Only reads the PNG header.
+        if (QImageReader(path).text(kSplashHashKey) == SplashHash(image)) {
+          // Still mark it as recently used, so that eviction spares it.
+          QFile file(path);
+          if (!file.open(QIODevice::ReadWrite) ||
+              !file.setFileTime(QDateTime::currentDateTime(),
+                                QFileDevice::FileModificationTime)) {
+            qWarning() << "could not touch splash" << path;
+          }
+          return;
+        }
+        SaveSplash(image, path);
+      });
 }
 
 void ProloGreet::SetLanguage(const QString& language) {
@@ -297,8 +799,37 @@ QVariant GreetJS::KeyboardLayouts() {
   return QVariant::fromValue(list);
 }
 
+bool GreetJS::IsLightDMConnected() { return prolo_->lightdm_connected_; }
+
+int GreetJS::SearchUsers(const QString& prefix, int offset, int limit) {
+  if (!prolo_->users_) return -1;
+  return prolo_->users_->search(prefix, offset, limit);
+}
+
 void GreetJS::SetKeyboardLayout(int id) { prolo_->keyboard_->setLayout(id); }
 
+QVariant GreetJS::SearchKeyboardLayouts(const QString& query, int limit) {
+  QVariantList list;
+  for (const auto& entry :
+       prolo_->layout_catalog_->search(query, qBound(1, limit, 100))) {
+    QVariantMap map;
+    map.insert("layout", entry.layout);
+    map.insert("variant", entry.variant);
+    map.insert("description", entry.description);
+    list.append(map);
+  }
+  return QVariant::fromValue(list);
+}
+
+bool GreetJS::AddKeyboardLayout(const QString& layout,
+                                const QString& variant) {
+  if (!prolo_->layout_catalog_->contains(layout, variant)) {
+    qWarning() << "unknown keyboard layout" << layout << variant;
+    return false;
+  }
+  return prolo_->keyboard_->addLayout(layout, variant);
+}
+
 void GreetJS::Authenticate(const QString& username, const QString& password,
                            const QString& session) {
   prolo_->StartLightDmAuthentication(username, password, session);
@@ -2,11 +2,21 @@
 
 #include <QLabel>
 #include <QLightDM/Greeter>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QPointer>
 #include <QStackedLayout>
+#include <QWebEnginePage>
 #include <QWidget>
 
 #include "KeyboardModel.h"
+#include "LayoutCatalog.h"
+#include "UserDirectory.h"
 
+class ControlServer;
+class MirrorRace;
+class QTimer;
+class QWebEngineProfile;
 class QWebEngineView;
 class QWebChannel;
 class GreetJS;
@@ -35,8 +45,28 @@ constexpr char kFallbackUrl[] = "qrc:/fallback/login.html";
 
 struct Options {
   QString url = kFallbackUrl;
+  // Mirrors of 'url', in order of preference, including it. If there is more
+  // than one, they are raced and the first one to answer is loaded.
+  QStringList mirrors;
+  // Milliseconds a mirror has to answer.
+  int mirror_timeout = 1500;
+  // Maximum per-host delay, in milliseconds, before probing mirrors.
+  int mirror_jitter = 500;
   int fallback_delay = 2000;
+  // Milliseconds to keep retrying to connect to LightDM before exiting, as
+  // long as the channel to the daemon is still open.
+  int lightdm_connect_deadline = 6000;
   QColor background_color = Qt::black;
+  // Directory where the greeter keeps data across starts, eg. the splash
+  // snapshot. Empty disables caching.
+  QString cache_dir;
+  // Maximum size of the web cache in cache_dir, in MiB. Positive.
+  int web_cache_size = 64;
+  // Path of the Unix socket to listen on for control commands. Empty
+  // disables it. See ControlServer.
+  QString control_socket;
+  // Whether to offer login autocompletion from the user directory (NSS).
+  bool user_search = false;
 };
 
 struct XSession {
@@ -50,12 +80,18 @@ class ProloGreet : public QWidget {
   explicit ProloGreet(Options options, QWidget* parent = nullptr);
   ~ProloGreet() override = default;
 
-  bool Start() __attribute__((warn_unused_result));
+  void Start();
 
  private slots:
   // Internal webview events.
+  void OnWebviewLoadStart();
   void OnWebviewLoadFinish(bool ok);
   void MaybeFallbackToInternalGreeter();
+  void CaptureSplash();
+  void OnRenderProcessTerminated(
+      QWebEnginePage::RenderProcessTerminationStatus status, int exit_code);
+  void PingRenderer();
+  void OnMirrorRaceFinished(const QUrl& winner);
 
   // LightDM events.
   void OnLightDMMessage(const QString& message,
@@ -75,30 +111,108 @@ class ProloGreet : public QWidget {
  private:
   QList<XSession> AvailableSessions() const;
 
+  // Creates the LightDM greeter object and connects its signals.
+  void CreateLightDMGreeter();
+  // Connects to LightDM, retrying with exponential backoff until the deadline.
+  // Exits right away if the channel to the daemon is closed.
+  void ConnectToLightDM();
+
+  // Loads the configured theme: races the mirrors if there are several, and
+  // loads the winner; otherwise loads the single URL right away. Cancels any
+  // race in progress.
+  void LoadTheme();
+  // Loads 'url' in the webview, falling back to the internal greeter if it
+  // does not load in time.
+  void LoadUrl(const QUrl& url);
+  // Reloads the page after the renderer died, or switches to the internal
+  // greeter if it keeps dying.
+  void RecoverFromRendererFailure();
+  // Cancels any in-flight LightDM authentication and resets the auth state.
+  void CancelAuthentication();
+
+  // For ControlServer (friend class).
+  // Loads the theme again from 'url', or the configured mirrors if empty.
+  // Returns false if an authentication is in flight, in which case the reload
+  // happens once it is over.
+  bool ReloadTheme(const QUrl& url);
+  void MaybeRunDeferredReload();
+  QJsonObject DumpState() const;
+
+  // Path of the cached splash snapshot for the current URL & screen geometry.
+  // Empty if caching is disabled.
+  QString SplashPath() const;
+  void ShowCachedSplash();
+  void HideSplash();
+
   State state_;
   Options options_;
+  QElapsedTimer startup_time_;
   bool webview_load_success_ = false;
   bool webview_uses_fallback_ = false;
+  QUrl webview_url_;
+  QTimer* fallback_timer_;
+  // Theme URL the greeter settled on: the mirror race winner, or the single
+  // configured URL. Unlike webview_url_, never the internal greeter.
+  QUrl theme_url_;
+  // The race in progress, if any.
+  QPointer<MirrorRace> mirror_race_;
+  // Whether the next theme load must skip the HTTP cache, after a reload.
+  bool bypass_cache_ = false;
+  // Whether the page being loaded must be reloaded without the cache once it
+  // has committed.
+  bool bypass_cache_after_load_ = false;
+
+  // Renderer watchdog. Pings the page periodically; a ping left unanswered for
+  // too long means the renderer hangs and is killed.
+  QTimer* renderer_watchdog_;
+  int renderer_ping_id_ = 0;
+  bool renderer_ping_pending_ = false;
+  bool renderer_hung_ = false;
+  QElapsedTimer renderer_ping_sent_;
+  // Renderer failures, for diagnostics and to give up on a crashing page.
+  int renderer_crash_count_ = 0;
+  int renderer_hang_count_ = 0;
+  int renderer_recent_failures_ = 0;
+  QElapsedTimer renderer_last_failure_;
+
+  // Theme reload requested through the control socket while authenticating.
+  bool reload_deferred_ = false;
+  QUrl deferred_reload_url_;
 
   // The UI elements.
   QStackedLayout* layout_;
   QLabel* status_info_;
+  // Static snapshot of the last rendered page, shown until the webview is
+  // ready. Null if there is no snapshot or once the webview is revealed.
+  QLabel* splash_ = nullptr;
   QWebEngineView* webview_;
+  QWebEngineProfile* profile_;
 
   // The communication channel to JavaScript world.
   QWebChannel* channel_;
   GreetJS* js_;
 
   // The communication channel with LightDM, power and session APIs.
-  QLightDM::Greeter* lightdm_;
+  QLightDM::Greeter* lightdm_ = nullptr;
+  bool lightdm_connected_ = false;
+  QElapsedTimer lightdm_connect_time_;
+  int lightdm_retry_delay_ = 0;
   QLightDM::PowerInterface* lightdm_power_;
   QLightDM::SessionsModel* lightdm_sessions_;
 
   // The KeyboardModel to watch for capslock & numlock & layout changes, and
   // update layout.
   KeyboardModel* keyboard_;
+  // All the layouts that can be added to keyboard_.
+  LayoutCatalog* layout_catalog_;
+
+  ControlServer* control_ = nullptr;
+
+  // Index of the user directory for login autocompletion. Null if disabled.
+  UserDirectory* users_ = nullptr;
 
   friend class GreetJS;
+  friend class ControlServer;
 };
 
 class GreetJS : public QObject {
@@ -124,6 +238,13 @@ class GreetJS : public QObject {
   // Signal sent to JS when available keyboard layouts change. Retrieve layouts
   // with KeyboardLayouts().
   void OnKeyboardLayoutsChange();
+  // Signal sent to JS when the connection to LightDM is lost or established.
+  // Authentication is impossible while disconnected.
+  void OnLightDMConnectionChange(bool connected);
+  // Signal sent to JS with a page of results for the SearchUsers() query 'id'.
+  // 'users' is a list of {login: "login", name: "Full Name"}; 'more' is true
+  // if there are results past this page.
+  void OnUserSearchResults(int id, const QVariant& users, bool more);
 
 #pragma clang diagnostic push
 #pragma ide diagnostic ignored "UnusedGlobalDeclarationInspection"
@@ -136,10 +257,31 @@ class GreetJS : public QObject {
   // Returns a list of {short: "short layout name", long: "long layout name"}
   Q_INVOKABLE QVariant KeyboardLayouts();
 
+  // Invoked through JS to know whether LightDM is connected, ie. whether
+  // Authenticate() can be used. See OnLightDMConnectionChange().
+  Q_INVOKABLE bool IsLightDMConnected();
+
+  // Invoked through JS to search users whose login starts with 'prefix'.
+  // Returns a query id, or -1 if user search is disabled. Results are sent
+  // with OnUserSearchResults(), possibly more than once as the directory
+  // answers. A new search supersedes the previous ones.
+  Q_INVOKABLE int SearchUsers(const QString& prefix, int offset, int limit);
+
   // Invoked through JS to change the current layout.
   // Will emit OnKeyboardLayoutChange() if successful.
   Q_INVOKABLE void SetKeyboardLayout(int id);
 
+  // Invoked through JS to search all the layouts known to xkb, not only the
+  // available ones. Returns a list of up to 'limit'
+  // {layout: "fr", variant: "bepo", description: "French (BEPO)"}.
+  Q_INVOKABLE QVariant SearchKeyboardLayouts(const QString& query, int limit);
+
+  // Invoked through JS to add a layout from SearchKeyboardLayouts() to the
+  // available ones and switch to it. Will emit OnKeyboardLayoutsChange() then
+  // OnKeyboardLayoutChange() if successful.
+  Q_INVOKABLE bool AddKeyboardLayout(const QString& layout,
+                                     const QString& variant);
+
   // Invoked through JS to start the authentication process.
   Q_INVOKABLE void Authenticate(const QString& username,
                                 const QString& password,
@@ -0,0 +1,243 @@
+#include "UserDirectory.h"
+
+#include "HostJitter.h"
+
+#include <pwd.h>
+#include <unistd.h>
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QTextStream>
+#include <QThread>
+#include <QTimer>
+#include <algorithm>
+
+namespace {
+
+// System accounts are not offered as suggestions.
+constexpr uid_t kMinUid = 1000;
+constexpr uid_t kNobodyUid = 65534;
+// Users enumerated between two lookups.
+constexpr int kEnumerationBatchSize = 256;
+// A snapshot younger than this is trusted as is; users missing from it are
+// still found through lookups.
+constexpr qint64 kSnapshotMaxAgeS = 60 * 60;
+// Maximum per-host delay before refreshing a stale snapshot, so that a room
+// booting at once doesn't enumerate the directory in lockstep.
+constexpr int kRefreshJitterMs = 60 * 1000;
+// How long to wait for a busy worker at exit before abandoning it.
+constexpr int kShutdownTimeoutMs = 200;
+
+bool LoginLess(const UserEntry& a, const UserEntry& b) {
+  return a.login < b.login;
+}
+
+bool IsHumanUser(const passwd* pw) {
+  return pw->pw_uid >= kMinUid && pw->pw_uid != kNobodyUid;
+}
+
+UserEntry ToUserEntry(const passwd* pw) {
+  // The GECOS field is "Full Name,room,phone,...".
+  return {QString::fromLocal8Bit(pw->pw_name),
+          QString::fromLocal8Bit(pw->pw_gecos).section(',', 0, 0)};
+}
+
+// Merges 'users' into the sorted 'index', in place. Existing entries win.
+void Merge(QVector<UserEntry> users, QVector<UserEntry>* index) {
+  std::sort(users.begin(), users.end(), LoginLess);
+  const int middle = index->size();
+  *index += users;
+  std::inplace_merge(index->begin(), index->begin() + middle, index->end(),
+                     LoginLess);
+  index->erase(std::unique(index->begin(), index->end(),
+                           [](const UserEntry& a, const UserEntry& b) {
+                             return a.login == b.login;
+                           }),
+               index->end());
+}
+
+}  // namespace
+
+UserDirectoryWorker::UserDirectoryWorker(
+    QString snapshot_path, std::shared_ptr<std::atomic<int>> latest_query)
+    : QObject(),
+      snapshot_path_(std::move(snapshot_path)),
+      latest_query_(std::move(latest_query)) {}
+
+void UserDirectoryWorker::start() {
+  QFile file(snapshot_path_);
+  if (snapshot_path_.isEmpty() || !file.open(QIODevice::ReadOnly)) {
+    // Nothing to serve in the meantime; enumerate right away.
+    enumerate();
+    return;
+  }
+  QVector<UserEntry> users;
+  QTextStream in(&file);
+  QString line;
+  while (in.readLineInto(&line)) {
+    users.append({line.section('\t', 0, 0), line.section('\t', 1)});
+  }
+  qDebug() << "loaded" << users.size() << "users from snapshot";
+  emit usersFound(users);
+
+  const qint64 age = QFileInfo(file).lastModified().secsTo(
+      QDateTime::currentDateTime());
+  if (age >= 0 && age < kSnapshotMaxAgeS) return;
+  const int jitter = HostJitter(kRefreshJitterMs);
+  qDebug() << "user snapshot is" << age << "s old; refreshing in" << jitter
+           << "ms";
+  QTimer::singleShot(jitter, this, &UserDirectoryWorker::enumerate);
+}
+
+void UserDirectoryWorker::enumerate() {
+  setpwent();
+  enumerateBatch();
+}
+
+void UserDirectoryWorker::enumerateBatch() {
+  QVector<UserEntry> users;
+  bool done = false;
+  while (users.size() < kEnumerationBatchSize) {
+    const passwd* pw = getpwent();
+    if (!pw) {
+      done = true;
+      break;
+    }
+    if (IsHumanUser(pw)) users.append(ToUserEntry(pw));
+  }
+  enumerated_ += users;
+  if (!users.isEmpty()) emit usersFound(users);
+
+  if (!done) {
+    // Give pending lookups a chance to run.
+    QMetaObject::invokeMethod(this, &UserDirectoryWorker::enumerateBatch,
+                              Qt::QueuedConnection);
+    return;
+  }
+  endpwent();
+  std::sort(enumerated_.begin(), enumerated_.end(), LoginLess);
+  qDebug() << "enumerated" << enumerated_.size() << "users";
+  saveSnapshot();
+  emit enumerationFinished(enumerated_);
+  enumerated_.clear();
+}
+
+void UserDirectoryWorker::lookup(int query, const QString& login) {
+  // Superseded while waiting in the queue.
+  if (query != latest_query_->load()) return;
+  passwd pwd{};
+  passwd* pw = nullptr;
+  QByteArray buffer(16384, 0);
+  const QByteArray name = login.toLocal8Bit();
+  if (getpwnam_r(name.constData(), &pwd, buffer.data(), buffer.size(), &pw) ==
+          0 &&
+      pw && IsHumanUser(pw)) {
+    emit userFound(query, ToUserEntry(pw));
+  }
+}
+
+void UserDirectoryWorker::saveSnapshot() const {
+  if (snapshot_path_.isEmpty()) return;
+  QSaveFile file(snapshot_path_);
+  if (!QDir().mkpath(QFileInfo(snapshot_path_).path()) ||
+      !file.open(QIODevice::WriteOnly)) {
+    qWarning() << "could not write user snapshot" << snapshot_path_;
+    return;
+  }
+  QTextStream out(&file);
+  for (const auto& user : enumerated_) {
+    out << user.login << '\t' << user.name << '\n';
+  }
+  out.flush();
+  if (!file.commit()) {
+    qWarning() << "could not write user snapshot" << snapshot_path_;
+  }
+}
+
+UserDirectory::UserDirectory(QString snapshot_path, QObject* parent)
+    : QObject(parent),
+      latest_query_(std::make_shared<std::atomic<int>>(0)),
+      thread_(new QThread()),
+      worker_(new UserDirectoryWorker(std::move(snapshot_path),
+                                      latest_query_)) {
+  qRegisterMetaType<UserEntry>();
+  qRegisterMetaType<QVector<UserEntry>>();
+
+  worker_->moveToThread(thread_);
+  connect(thread_, &QThread::started, worker_, &UserDirectoryWorker::start);
+  connect(thread_, &QThread::finished, worker_, &QObject::deleteLater);
+  connect(this, &UserDirectory::lookupRequested, worker_,
+          &UserDirectoryWorker::lookup);
+  connect(worker_, &UserDirectoryWorker::usersFound, this,
+          &UserDirectory::onUsersFound);
+  connect(worker_, &UserDirectoryWorker::enumerationFinished, this,
+          &UserDirectory::onEnumerationFinished);
+  connect(worker_, &UserDirectoryWorker::userFound, this,
+          &UserDirectory::onUserFound);
+  thread_->start(QThread::LowPriority);
+}
+
+UserDirectory::~UserDirectory() {
+  thread_->quit();
+  // The worker may be stuck on a slow directory; don't hold the exit for it.
+  if (thread_->wait(kShutdownTimeoutMs)) {
+    delete thread_;
+  } else {
+    qWarning() << "user directory is busy; abandoning it";
+  }
+}
+
+int UserDirectory::search(const QString& prefix, int offset, int limit) {
+  query_ = {latest_query_->fetch_add(1) + 1, prefix, qMax(0, offset),
+            qBound(1, limit, 50)};
+  // Results are always sent asynchronously, after the id is returned.
+  QMetaObject::invokeMethod(this, &UserDirectory::emitResults,
+                            Qt::QueuedConnection);
+
+  const auto it = std::lower_bound(index_.begin(), index_.end(),
+                                   UserEntry{prefix, {}}, LoginLess);
+  const bool known = it != index_.end() && it->login == prefix;
+  if (!known && !prefix.isEmpty()) emit lookupRequested(query_.id, prefix);
+  return query_.id;
+}
+
+void UserDirectory::emitResults() {
+  QVector<UserEntry> users;
+  bool more = false;
+  if (!query_.prefix.isEmpty()) {
+    auto it = std::lower_bound(index_.begin(), index_.end(),
+                               UserEntry{query_.prefix, {}}, LoginLess);
+    int skipped = 0;
+    for (; it != index_.end() && it->login.startsWith(query_.prefix); ++it) {
+      if (skipped < query_.offset) {
+        skipped++;
+      } else if (users.size() < query_.limit) {
+        users.append(*it);
+      } else {
+        more = true;
+        break;
+      }
+    }
+  }
+  emit resultsReady(query_.id, users, more);
+}
+
+void UserDirectory::onUsersFound(const QVector<UserEntry>& users) {
+  Merge(users, &index_);
+}
+
+void UserDirectory::onEnumerationFinished(const QVector<UserEntry>& users) {
+  // Drops users that were removed since the snapshot.
+  index_ = users;
+  Merge(looked_up_, &index_);
+}
+
+void UserDirectory::onUserFound(int query, const UserEntry& user) {
+  Merge({user}, &looked_up_);
+  Merge({user}, &index_);
+  if (query == query_.id) emitResults();
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <QMetaType>
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <atomic>
+#include <memory>
+
+class QThread;
+
+struct UserEntry {
+  QString login;
+  QString name;
+};
+Q_DECLARE_METATYPE(UserEntry)
+Q_DECLARE_METATYPE(QVector<UserEntry>)
+
+// Does the potentially slow directory (NSS) calls and snapshot I/O. Lives in
+// its own thread.
+class UserDirectoryWorker : public QObject {
+  Q_OBJECT
+ public:
+  UserDirectoryWorker(QString snapshot_path,
+                      std::shared_ptr<std::atomic<int>> latest_query);
+
+ public slots:
+  // Loads the snapshot, then, if it is missing or stale, enumerates the
+  // directory one batch at a time so that lookups are served in between.
+  void start();
+  void lookup(int query, const QString& login);
+
+ signals:
+  void usersFound(const QVector<UserEntry>& users);
+  void enumerationFinished(const QVector<UserEntry>& users);
+  void userFound(int query, const UserEntry& user);
+
+ private slots:
+  void enumerate();
+  void enumerateBatch();
+
+ private:
+  void saveSnapshot() const;
+
+  const QString snapshot_path_;
+  std::shared_ptr<std::atomic<int>> latest_query_;
+  QVector<UserEntry> enumerated_;
+};
+
+// Prefix index over the user directory, for login autocompletion. The index
+// is seeded from an on-disk snapshot and refreshed in the background; searches
+// never wait for the directory.
+class UserDirectory : public QObject {
+  Q_OBJECT
+ public:
+  // 'snapshot_path' may be empty to disable the snapshot.
+  explicit UserDirectory(QString snapshot_path, QObject* parent = nullptr);
+  ~UserDirectory() override;
+
+  // Starts a search for logins starting with 'prefix', superseding previous
+  // ones. Returns the query id; results are sent with resultsReady().
+  int search(const QString& prefix, int offset, int limit);
+
+ signals:
+  void resultsReady(int query, const QVector<UserEntry>& users, bool more);
+  // For the worker.
+  void lookupRequested(int query, const QString& login);
+
+ private slots:
+  void onUsersFound(const QVector<UserEntry>& users);
+  void onEnumerationFinished(const QVector<UserEntry>& users);
+  void onUserFound(int query, const UserEntry& user);
+
+ private:
+  void emitResults();
+
+  // Sorted by login, without duplicates.
+  QVector<UserEntry> index_;
+  // Users only known through lookups, kept across refreshes. Sorted by login,
+  // without duplicates.
+  QVector<UserEntry> looked_up_;
+
+  struct Query {
+    int id = 0;
+    QString prefix;
+    int offset = 0;
+    int limit = 0;
+  } query_;
+  std::shared_ptr<std::atomic<int>> latest_query_;
+
+  QThread* thread_;
+  UserDirectoryWorker* worker_;
+};
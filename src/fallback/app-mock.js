@@ -48,12 +48,38 @@
         {short: "fr", long: "French (alternative)"},
       ]);
     },
+    IsLightDMConnected: function () {
+      console.log("called IsLightDMConnected()");
+      return Promise.resolve(true);
+    },
+    SearchUsers: function (prefix, offset, limit) {
+      const that = this;
+      console.log(`called SearchUsers(${prefix}, ${offset}, ${limit})`);
+      const id = (this.lastSearch = (this.lastSearch || 0) + 1);
+      const users = ["alice", "albert", "bob", "carol"]
+        .filter(u => prefix.length && u.startsWith(prefix))
+        .map(u => ({login: u, name: u[0].toUpperCase() + u.slice(1)}));
+      setTimeout(() => that.OnUserSearchResults.notify(id, users, false), 50);
+      return Promise.resolve(id);
+    },
     SetKeyboardLayout: function () {
       const that = this;
       console.log(`called SetKeyboardLayout(${arguments})`);
       setTimeout(() => that.OnKeyboardLayoutChange.notify(arguments[0]),
         150);
     },
+    SearchKeyboardLayouts: function (query, limit) {
+      console.log(`called SearchKeyboardLayouts(${query}, ${limit})`);
+      return Promise.resolve([
+        {layout: "fr", variant: "bepo", description: "French (BEPO)"},
+        {layout: "de", variant: "", description: "German"},
+      ].filter(l => l.description.toLowerCase().includes(query.toLowerCase()))
+        .slice(0, limit));
+    },
+    AddKeyboardLayout: function (layout, variant) {
+      console.log(`called AddKeyboardLayout(${layout}, ${variant})`);
+      return Promise.resolve(true);
+    },
     SetLanguage: function (l) {
       alert(`Setting language to ${l}`)
     },
@@ -70,6 +96,8 @@
     OnKeyboardLayoutsChange: fakeSignal(),
     OnCapsLockChange: fakeSignal(),
     OnNumLockChange: fakeSignal(),
+    OnLightDMConnectionChange: fakeSignal(),
+    OnUserSearchResults: fakeSignal(),
   };
 
   window.QWebChannel = function (transport, callback) {
@@ -7,6 +7,7 @@ function invalidShake($el) {
   const $form = document.getElementById('form');
   const $status = document.getElementById('text-status');
   const $username = document.getElementById('input-username');
+  const $users = document.getElementById('users');
   const $password = document.getElementById('input-password');
   const $capslock = document.getElementById('capslock');
   const $numlock = document.getElementById('numlock');
@@ -23,6 +24,7 @@ function invalidShake($el) {
 
   let prologin;
   let statusTimeout;
+  let latestUserSearch = -1;
 
   $poweroff.onclick = (e) => {
     e.preventDefault();
@@ -81,14 +83,20 @@ function invalidShake($el) {
       });
   }
 
-  function setStatus(message, isError) {
+  function clearStatus() {
+    clearTimeout(statusTimeout);
+    $status.innerHTML = "&nbsp;";
+    $status.classList.toggle("error", false);
+  }
+
+  // A status set with persistent = true stays until replaced or cleared.
+  function setStatus(message, isError, persistent = false) {
     $status.classList.toggle("error", isError);
     $status.textContent = message;
-    clearInterval(statusTimeout);
-    statusTimeout = setTimeout(() => {
-      $status.innerHTML = "&nbsp;";
-      $status.classList.toggle("error", false);
-    }, 8000);
+    clearTimeout(statusTimeout);
+    if (!persistent) {
+      statusTimeout = setTimeout(clearStatus, 8000);
+    }
   }
 
   function onStatusMessage(message, isError) {
@@ -113,6 +121,34 @@ function invalidShake($el) {
     createLayoutRadios(await prologin.KeyboardLayouts());
   }
 
+  function onLightDMConnectionChange(connected) {
+    $interactiveElements.forEach(e => e.disabled = !connected);
+    $indicators.forEach(e => e.classList.toggle('disabled', !connected));
+    if (connected) {
+      clearStatus();
+      $username.focus();
+    } else {
+      setStatus("waiting for the login manager…", false, true);
+    }
+  }
+
+  async function searchUsers() {
+    const id = await prologin.SearchUsers($username.value, 0, 10);
+    latestUserSearch = Math.max(latestUserSearch, id);
+  }
+
+  function onUserSearchResults(id, users) {
+    if (id < latestUserSearch) return;
+    latestUserSearch = id;
+    $users.innerHTML = '';
+    users.forEach(u => {
+      const $option = document.createElement("option");
+      $option.value = u.login;
+      $option.textContent = u.name;
+      $users.appendChild($option);
+    });
+  }
+
   function onKeyboardLayoutChange(id) {
     document.querySelector(`#layouts-${id}`).checked = true;
   }
@@ -166,6 +202,10 @@ function invalidShake($el) {
     prologin.OnNumLockChange.connect(onNumLockChange);
     prologin.OnKeyboardLayoutsChange.connect(onKeyboardLayoutsChange);
     prologin.OnKeyboardLayoutChange.connect(onKeyboardLayoutChange);
+    prologin.OnLightDMConnectionChange.connect(onLightDMConnectionChange);
+    prologin.OnUserSearchResults.connect(onUserSearchResults);
+    $username.addEventListener('input', searchUsers);
+    if (!await prologin.IsLightDMConnected()) onLightDMConnectionChange(false);
   });
 
 })();
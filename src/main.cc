@@ -2,7 +2,7 @@
 #include <QFile>
 #include <QNetworkProxy>
 #include <QSettings>
-#include <QTimer>
+#include <QStandardPaths>
 #include <iostream>
 
 #include "ProloGreet.h"
@@ -27,13 +27,39 @@ int main(int argc, char** argv) {
   Options options;
   QSettings conf(conf_path, QSettings::IniFormat);
   conf.beginGroup("greeter");
-  const QString url = conf.value("url").toString();
-  if (!url.isEmpty()) options.url = url;
+  // A comma-separated list of mirrors is also accepted.
+  const QStringList urls = conf.value("url").toStringList();
+  if (!urls.isEmpty() && !urls.first().isEmpty()) {
+    options.url = urls.first();
+    options.mirrors = urls;
+  }
   const QColor bg_color(conf.value("background_color").toString());
   if (bg_color.isValid()) options.background_color = bg_color;
   bool ok;
   const int delay = conf.value("fallback_delay").toInt(&ok);
   if (ok) options.fallback_delay = delay;
+  const int deadline = conf.value("lightdm_connect_deadline").toInt(&ok);
+  if (ok) options.lightdm_connect_deadline = deadline;
+  const int mirror_timeout = conf.value("mirror_timeout").toInt(&ok);
+  if (ok) options.mirror_timeout = mirror_timeout;
+  const int mirror_jitter = conf.value("mirror_jitter").toInt(&ok);
+  if (ok) options.mirror_jitter = mirror_jitter;
+  const QString default_cache_dir =
+      QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+  options.cache_dir = conf.value("cache_dir", default_cache_dir).toString();
+  const QVariant web_cache_size = conf.value("web_cache_size");
+  if (web_cache_size.isValid()) {
+    // 0 would let Chromium size the cache itself.
+    const int size = web_cache_size.toInt(&ok);
+    if (ok && size > 0) {
+      options.web_cache_size = size;
+    } else {
+      std::cerr << "invalid web_cache_size: "
+                << web_cache_size.toString().toStdString() << "\n";
+    }
+  }
+  options.control_socket = conf.value("control_socket").toString();
+  options.user_search = conf.value("user_search", false).toBool();
   const auto& proxy_spec = conf.value("http_proxy").toString();
   conf.endGroup();
   if (conf.status() != QSettings::NoError) {
@@ -61,9 +87,7 @@ int main(int argc, char** argv) {
   ProloGreet greeter(options);
   greeter.show();
   QApplication::processEvents(QEventLoop::AllEvents);
-  if (!greeter.Start()) {
-    QTimer::singleShot(6000, []() { QApplication::exit(42); });
-  }
+  greeter.Start();
 
   int ret = QApplication::exec();
   std::cerr << "exited gracefully with code " << ret << "\n";